@@ -0,0 +1,258 @@
+#ifndef BILLING_BILL_EXPORT_H
+#define BILLING_BILL_EXPORT_H
+
+// Columnar binary export of bill line items, for consumers that would otherwise re-parse the CSV bills.
+//
+// File layout (little-endian, every section 8-byte aligned so it can be read in place from an mmap):
+//
+//   ColumnarFileHeader
+//   ColumnarColumnEntry[columnCount]
+//   ColumnarChunkEntry[rowGroupCount][columnCount]   row group major
+//   dictionaries                                      one per Dictionary column
+//   column chunks                                     one per row group and column
+//
+// A chunk holds the values of one column for the rows of one row group:
+//   Int32      int32_t per row
+//   Decimal64  int64_t per row, the value times 10^scale
+//   Dictionary uint32_t code per row into the column's dictionary
+// A dictionary is uint32_t count, uint32_t offsets[count + 1] into the bytes that follow, then the
+// UTF-8 bytes. Entries are sorted, so code order is string order and min/max codes bound the strings.
+// Column entries carry min/max over the whole file and chunk entries over their row group, letting a
+// reader skip row groups that cannot match.
+
+#include "billing.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace billing
+{
+
+enum ColumnType : std::uint32_t
+{
+    Int32 = 1,
+    Decimal64 = 2,
+    Dictionary = 3,
+};
+
+struct ColumnarFileHeader
+{
+    char magic[8]; // "AWSBILL\0"
+    std::uint32_t version;
+    std::uint32_t columnCount;
+    std::uint64_t rowCount;
+    std::uint32_t rowGroupSize;
+    std::uint32_t rowGroupCount;
+};
+
+struct ColumnarColumnEntry
+{
+    char name[32]; // NUL padded
+    std::uint32_t type;
+    std::uint32_t scale; // Decimal places of a Decimal64 column
+    std::int64_t min;
+    std::int64_t max;
+    std::uint64_t dictionaryOffset; // 0 unless type is Dictionary
+};
+
+struct ColumnarChunkEntry
+{
+    std::uint64_t offset;
+    std::uint64_t rowCount;
+    std::int64_t min;
+    std::int64_t max;
+};
+
+// The values and tables above are written as they are laid out in memory, so the host has to match the file
+#if defined(__BYTE_ORDER__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The columnar bill format is little-endian");
+#endif
+static_assert(sizeof(ColumnarFileHeader) == 32 && sizeof(ColumnarColumnEntry) == 64 && sizeof(ColumnarChunkEntry) == 32,
+              "Columnar file tables must have no padding");
+
+const std::uint32_t columnarFormatVersion = 1;
+const std::uint32_t columnarDecimalScale = 6; // Hours and dollars are stored in millionths
+
+namespace detail
+{
+
+struct ExportColumn
+{
+    const char *name;
+    ColumnType type;
+    std::function<std::int64_t(const BillLineItem &)> integerValue;    // Int32, Decimal64
+    std::function<const std::string &(const BillLineItem &)> textValue; // Dictionary
+};
+
+inline std::int64_t toFixedPoint(double value)
+{
+    return std::llround(value * 1e6);
+}
+
+// YYYY-MM -> YYYYMM
+inline std::int64_t monthNumber(const std::string &monthYear)
+{
+    return monthYear.size() >= 7 ? std::stoll(monthYear.substr(0, 4)) * 100 + std::stoll(monthYear.substr(5, 2)) : 0;
+}
+
+inline std::vector<ExportColumn> exportColumns()
+{
+    return {
+        {"customer_id", Dictionary, nullptr, [](const BillLineItem &l) -> const std::string & { return l.customerId; }},
+        {"month", Int32, [](const BillLineItem &l) { return monthNumber(l.monthYear); }, nullptr},
+        {"region", Dictionary, nullptr, [](const BillLineItem &l) -> const std::string & { return l.region; }},
+        {"resource_type", Dictionary, nullptr, [](const BillLineItem &l) -> const std::string & { return l.resourceType; }},
+        {"os", Dictionary, nullptr, [](const BillLineItem &l) -> const std::string & { return l.os; }},
+        {"resource_id", Dictionary, nullptr, [](const BillLineItem &l) -> const std::string & { return l.resourceId; }},
+        {"is_own_ip", Int32, [](const BillLineItem &l) { return std::int64_t(l.isOwnIP ? 1 : 0); }, nullptr},
+        {"total_resources", Int32, [](const BillLineItem &l) { return std::int64_t(l.totalResources); }, nullptr},
+        {"used_hours", Decimal64, [](const BillLineItem &l) { return toFixedPoint(l.usedHours); }, nullptr},
+        {"billed_hours", Decimal64, [](const BillLineItem &l) { return toFixedPoint(l.billedHours); }, nullptr},
+        {"rate_per_hour", Decimal64, [](const BillLineItem &l) { return toFixedPoint(l.ratePerHour); }, nullptr},
+        {"amount", Decimal64, [](const BillLineItem &l) { return toFixedPoint(l.amount); }, nullptr},
+        {"discount", Decimal64, [](const BillLineItem &l) { return toFixedPoint(l.discount); }, nullptr},
+        {"actual_amount", Decimal64, [](const BillLineItem &l) { return toFixedPoint(l.actualAmount); }, nullptr},
+    };
+}
+
+inline void pad8(std::string &buffer)
+{
+    buffer.append((8 - buffer.size() % 8) % 8, '\0');
+}
+
+template <typename T>
+void appendValue(std::string &buffer, T value)
+{
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+} // namespace detail
+
+// Writes every line item of a run to one columnar file. Returns false, after reporting the error,
+// when the file cannot be written.
+inline bool writeColumnarBills(const std::string &filename, const std::vector<BillLineItem> &lines,
+                               std::uint32_t rowGroupSize = 65536)
+{
+    std::vector<detail::ExportColumn> columns = detail::exportColumns();
+    rowGroupSize = std::max<std::uint32_t>(rowGroupSize, 1);
+    std::uint32_t rowGroupCount = static_cast<std::uint32_t>((lines.size() + rowGroupSize - 1) / rowGroupSize);
+
+    ColumnarFileHeader header = {};
+    std::memcpy(header.magic, "AWSBILL", 8);
+    header.version = columnarFormatVersion;
+    header.columnCount = static_cast<std::uint32_t>(columns.size());
+    header.rowCount = lines.size();
+    header.rowGroupSize = rowGroupSize;
+    header.rowGroupCount = rowGroupCount;
+
+    std::vector<ColumnarColumnEntry> columnEntries(columns.size());
+    std::vector<ColumnarChunkEntry> chunkEntries(std::size_t(rowGroupCount) * columns.size());
+
+    // Reserve room for the fixed-size tables; they are filled in once every offset is known
+    std::string buffer(sizeof(header) + sizeof(ColumnarColumnEntry) * columnEntries.size() +
+                           sizeof(ColumnarChunkEntry) * chunkEntries.size(),
+                       '\0');
+
+    // Dictionaries
+    std::vector<std::map<std::string, std::uint32_t>> dictionaries(columns.size());
+    for (std::size_t c = 0; c < columns.size(); ++c)
+    {
+        ColumnarColumnEntry &entry = columnEntries[c];
+        std::strncpy(entry.name, columns[c].name, sizeof(entry.name) - 1);
+        entry.type = columns[c].type;
+        entry.scale = columns[c].type == Decimal64 ? columnarDecimalScale : 0;
+        if (columns[c].type != Dictionary)
+            continue;
+
+        std::map<std::string, std::uint32_t> &dictionary = dictionaries[c];
+        for (const BillLineItem &line : lines)
+        {
+            dictionary.emplace(columns[c].textValue(line), 0);
+        }
+
+        entry.dictionaryOffset = buffer.size();
+        detail::appendValue(buffer, static_cast<std::uint32_t>(dictionary.size()));
+        std::uint32_t code = 0, byteOffset = 0;
+        for (auto &word : dictionary)
+        {
+            word.second = code++;
+            detail::appendValue(buffer, byteOffset);
+            byteOffset += static_cast<std::uint32_t>(word.first.size());
+        }
+        detail::appendValue(buffer, byteOffset);
+        for (const auto &word : dictionary)
+        {
+            buffer += word.first;
+        }
+        detail::pad8(buffer);
+    }
+
+    // Column chunks with their statistics
+    for (std::uint32_t group = 0; group < rowGroupCount; ++group)
+    {
+        std::size_t first = std::size_t(group) * rowGroupSize;
+        std::size_t last = std::min(lines.size(), first + rowGroupSize);
+
+        for (std::size_t c = 0; c < columns.size(); ++c)
+        {
+            ColumnarChunkEntry &chunk = chunkEntries[group * columns.size() + c];
+            chunk.offset = buffer.size();
+            chunk.rowCount = last - first;
+            chunk.min = std::numeric_limits<std::int64_t>::max();
+            chunk.max = std::numeric_limits<std::int64_t>::min();
+
+            for (std::size_t row = first; row < last; ++row)
+            {
+                std::int64_t value;
+                if (columns[c].type == Dictionary)
+                {
+                    value = dictionaries[c].at(columns[c].textValue(lines[row]));
+                    detail::appendValue(buffer, static_cast<std::uint32_t>(value));
+                }
+                else if (columns[c].type == Int32)
+                {
+                    value = columns[c].integerValue(lines[row]);
+                    detail::appendValue(buffer, static_cast<std::int32_t>(value));
+                }
+                else
+                {
+                    value = columns[c].integerValue(lines[row]);
+                    detail::appendValue(buffer, value);
+                }
+                chunk.min = std::min(chunk.min, value);
+                chunk.max = std::max(chunk.max, value);
+            }
+            detail::pad8(buffer);
+
+            ColumnarColumnEntry &entry = columnEntries[c];
+            entry.min = group == 0 ? chunk.min : std::min(entry.min, chunk.min);
+            entry.max = group == 0 ? chunk.max : std::max(entry.max, chunk.max);
+        }
+    }
+
+    char *tables = &buffer[0];
+    std::memcpy(tables, &header, sizeof(header));
+    std::memcpy(tables + sizeof(header), columnEntries.data(), sizeof(ColumnarColumnEntry) * columnEntries.size());
+    std::memcpy(tables + sizeof(header) + sizeof(ColumnarColumnEntry) * columnEntries.size(), chunkEntries.data(),
+                sizeof(ColumnarChunkEntry) * chunkEntries.size());
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.write(buffer.data(), buffer.size()))
+    {
+        std::cerr << "Error: Unable to write columnar export " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace billing
+
+#endif // BILLING_BILL_EXPORT_H
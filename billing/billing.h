@@ -0,0 +1,1030 @@
+#ifndef BILLING_BILLING_H
+#define BILLING_BILLING_H
+
+// In-process billing for all three enhancements. The load* functions read the CSV inputs;
+// the bill* functions take records already in memory and return bill line items without
+// touching the filesystem. Billing is split in two steps: the aggregate* functions reduce
+// usage to price-independent hours and priceAggregate prices those under any number of
+// rate tables (see scenarios.h). See billing_c.h for the C interface.
+
+#include "rates.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace billing
+{
+
+// enhancement0: AWSResourceUsage.csv
+struct InstanceUsage
+{
+    std::string customerId;
+    std::string instanceId;
+    std::string instanceType;
+    std::time_t usedFrom;
+    std::time_t usedUntil;
+};
+
+// enhancement1: AWSOnDemandResourceUsage.csv
+struct ResourceUsage
+{
+    std::string customerId;
+    std::string instanceId;
+    std::string resourceType;
+    std::string region;
+    std::string os;
+    std::time_t usedFrom;
+    std::time_t usedUntil;
+};
+
+// enhancement1: AWSReservedInstanceUsage.csv
+struct ReservedInstance
+{
+    std::string customerId;
+    std::string instanceId;
+    std::string resourceType;
+    std::string region;
+    std::string os;
+    double hourlyRate = 0.0;
+    int durationMonths = 0;
+};
+
+// Monthly free tier allowance when Region.csv does not give one
+const double defaultFreeTierHoursPerMonth = 750.0;
+
+// enhancement1: Region.csv
+struct RegionInfo
+{
+    std::string region;
+    std::string freeTierInstanceType;
+    double freeTierHoursPerMonth = defaultFreeTierHoursPerMonth;
+};
+
+// enhancement2: ElasticIPAllocation.csv
+struct ElasticIPAllocation
+{
+    std::string customer;
+    std::string region;
+    std::string elasticIP;
+    std::time_t usedFrom;
+    std::time_t usedUntil;
+    bool isOwnIP;
+};
+
+// enhancement2: ElasticIPAssociation.csv
+struct ElasticIPAssociation
+{
+    std::string ipAddress;
+    std::string ec2Instance;
+    std::time_t associatedFrom;
+    std::time_t associatedUntil;
+};
+
+// One row of a monthly bill. Fields a biller does not use are left empty or zero.
+struct BillLineItem
+{
+    std::string customerId;
+    std::string monthYear;    // YYYY-MM
+    std::string region;       // enhancement1, enhancement2
+    std::string resourceType; // EC2 instance type; enhancement0, enhancement1
+    std::string os;           // enhancement1
+    std::string resourceId;   // Elastic IP address; enhancement2
+    bool isOwnIP = false;     // enhancement2: the customer's own address, never billed
+    int totalResources = 1;
+    double usedHours = 0.0;
+    double billedHours = 0.0;
+    double ratePerHour = 0.0; // Effective rate, blended when the price changed during the month
+    double amount = 0.0;
+    double discount = 0.0;
+    double actualAmount = 0.0;
+};
+
+// A contiguous run of line items belonging to one customer's bill for one month
+struct MonthlyBill
+{
+    std::string customerId;
+    std::string monthYear;
+    const BillLineItem *begin;
+    const BillLineItem *end;
+};
+
+namespace detail
+{
+
+inline std::vector<std::string> splitCsvLine(const std::string &line)
+{
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ','))
+    {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+inline std::string fieldAt(const std::vector<std::string> &fields, std::size_t index)
+{
+    return index < fields.size() ? fields[index] : "";
+}
+
+// Numeric column that may be missing or hold a header; falls back to defaultValue
+inline double numberOr(const std::string &value, double defaultValue)
+{
+    char *end = nullptr;
+    double parsed = std::strtod(value.c_str(), &end);
+    return end != value.c_str() ? parsed : defaultValue;
+}
+
+inline bool openCsv(const std::string &filename, std::ifstream &file)
+{
+    file.open(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Usage no rate covers is billed nothing; say so, per rate key, rather than let it pass silently.
+// 'source' names the rate table when it is not the baseline.
+inline void reportUnpricedHours(const std::map<std::string, double> &unpricedHours, const std::string &source = "")
+{
+    for (const auto &entry : unpricedHours)
+    {
+        if (entry.second > 0)
+        {
+            std::ostringstream message;
+            message << "Warning: " << (source.empty() ? "" : source + ": ") << "no rate for " << entry.first << " covers " << std::fixed << std::setprecision(2)
+                    << entry.second << " hours of usage; they are billed $0.00";
+            std::cerr << message.str() << std::endl;
+        }
+    }
+}
+
+// Reads the Effective From and Effective Until columns at 'index' and 'index + 1' of a rate row. An
+// unparseable date is reported with the file and line, and false is returned so the row is skipped rather
+// than left open on that side, which would let it price all time.
+inline bool readEffectiveRange(const std::vector<std::string> &fields, std::size_t index, RateVersion &version,
+                               const std::string &filename, int lineNumber)
+{
+    for (std::size_t i = index; i < index + 2; ++i)
+    {
+        std::time_t &bound = i == index ? version.effectiveFrom : version.effectiveUntil;
+        if (!parseEffectiveTime(fieldAt(fields, i), bound))
+        {
+            std::cerr << "Error: Effective date invalid in " << filename << " line " << lineNumber << ": "
+                      << fields[i] << "; row skipped" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+// Loaders. Each returns false, after reporting the error, when the file cannot be opened.
+
+// Sr. No.,Customer ID,Customer Name
+inline bool loadCustomers(const std::string &filename, std::map<std::string, std::string> &customerNames)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    std::getline(file, line); // Skip header
+    while (std::getline(file, line))
+    {
+        std::vector<std::string> fields = detail::splitCsvLine(line);
+        customerNames[detail::fieldAt(fields, 1)] = detail::fieldAt(fields, 2);
+    }
+    return true;
+}
+
+// enhancement0: Sr. No.,Instance Type,Charge/Hour[,Effective From,Effective Until]
+inline bool loadInstanceRates(const std::string &filename, RateTable &rates)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    std::getline(file, line); // Skip header
+    int lineNumber = 1;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        std::vector<std::string> fields = detail::splitCsvLine(line);
+        if (fields.size() < 3)
+            continue;
+
+        RateVersion version;
+        version.ratePerHour = parseRate(fields[2]);
+        if (!detail::readEffectiveRange(fields, 3, version, filename, lineNumber))
+            continue;
+        addRateVersion(rates, fields[1], version);
+    }
+    sortRateTable(rates, filename);
+    return true;
+}
+
+// enhancement1: prices differ per region, so rates are keyed by region and instance type
+inline std::string resourceRateKey(const std::string &region, const std::string &instanceType)
+{
+    return region + "_" + instanceType;
+}
+
+// enhancement1: Sr. No.,Instance Type,Charge/Hour(OnDemand),Charge/Hour(Reserved),Region[,Effective From,Effective Until]
+// Charge/Hour(Reserved) is not read: reserved usage is billed at its AWSReservedInstanceUsage.csv rate.
+inline bool loadResourceTypeRates(const std::string &filename, RateTable &rates)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    std::getline(file, line); // Skip header
+    int lineNumber = 1;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        std::vector<std::string> fields = detail::splitCsvLine(line);
+        if (fields.size() < 5)
+            continue; // Ensure valid row
+
+        RateVersion version;
+        version.ratePerHour = parseRate(fields[2]);
+        if (!detail::readEffectiveRange(fields, 5, version, filename, lineNumber))
+            continue;
+        addRateVersion(rates, resourceRateKey(fields[4], fields[1]), version);
+    }
+    sortRateTable(rates, filename);
+    return true;
+}
+
+// enhancement2: Region,Rate/Hour[,Effective From,Effective Until]
+inline bool loadElasticIPRates(const std::string &filename, RateTable &rates)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    std::getline(file, line); // Skip header
+    int lineNumber = 1;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        std::vector<std::string> fields = detail::splitCsvLine(line);
+        if (fields.size() < 2)
+            continue;
+
+        RateVersion version;
+        version.ratePerHour = parseRate(fields[1]);
+        if (!detail::readEffectiveRange(fields, 2, version, filename, lineNumber))
+            continue;
+        addRateVersion(rates, fields[0], version);
+    }
+    sortRateTable(rates, filename);
+    return true;
+}
+
+// Sr. No.,Customer ID,EC2 Instance ID,EC2 Instance Type,Used from,Used Until
+inline bool loadInstanceUsages(const std::string &filename, std::vector<InstanceUsage> &usages)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    std::getline(file, line); // Skip header
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        std::vector<std::string> fields = detail::splitCsvLine(line);
+        std::time_t usedFrom = parseTimestamp(detail::fieldAt(fields, 4));
+        std::time_t usedUntil = parseTimestamp(detail::fieldAt(fields, 5));
+        if (usedFrom == -1 || usedUntil == -1)
+        {
+            std::cerr << "Error: Time format invalid for: " << line << std::endl;
+            continue;
+        }
+
+        usages.push_back({fields[1], fields[2], fields[3], usedFrom, usedUntil});
+    }
+    return true;
+}
+
+// Sr. No.,Customer ID,EC2 Instance ID,EC2 Instance Type,Used from,Used Until,Region,OS
+inline bool loadResourceUsages(const std::string &filename, std::vector<ResourceUsage> &usages)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    std::getline(file, line); // Skip header
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        std::vector<std::string> fields = detail::splitCsvLine(line);
+        std::time_t usedFrom = parseTimestamp(detail::fieldAt(fields, 4));
+        std::time_t usedUntil = parseTimestamp(detail::fieldAt(fields, 5));
+        if (usedFrom == -1 || usedUntil == -1)
+        {
+            std::cerr << "Error: Time format invalid for: " << line << std::endl;
+            continue;
+        }
+
+        usages.push_back({fields[1], fields[2], fields[3], detail::fieldAt(fields, 6), detail::fieldAt(fields, 7),
+                          usedFrom, usedUntil});
+    }
+    return true;
+}
+
+// Customer ID,EC2 Instance ID,EC2 Instance Type,Region,OS,Hourly Rate,Duration (Months)
+inline bool loadReservedInstances(const std::string &filename, std::vector<ReservedInstance> &reservedInstances)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    std::getline(file, line); // Skip header
+    while (std::getline(file, line))
+    {
+        std::stringstream ss(line);
+        ReservedInstance instance;
+        std::getline(ss, instance.customerId, ',');
+        std::getline(ss, instance.instanceId, ',');
+        std::getline(ss, instance.resourceType, ',');
+        std::getline(ss, instance.region, ',');
+        std::getline(ss, instance.os, ',');
+        ss >> instance.hourlyRate;
+        ss.ignore();
+        ss >> instance.durationMonths;
+
+        reservedInstances.push_back(instance);
+    }
+    return true;
+}
+
+// Region,Free Tier Eligible[,Free Tier Hours]
+inline bool loadRegionInfos(const std::string &filename, std::map<std::string, RegionInfo> &regionInfos)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::vector<std::string> fields = detail::splitCsvLine(line);
+        std::string region = detail::fieldAt(fields, 0);
+        regionInfos[region] = {region, detail::fieldAt(fields, 1),
+                               detail::numberOr(detail::fieldAt(fields, 2), defaultFreeTierHoursPerMonth)};
+    }
+    return true;
+}
+
+// Customer,Region,Elastic IP,Used From,Unsed Until,Your own IP?
+inline bool loadElasticIPAllocations(const std::string &filename, std::vector<ElasticIPAllocation> &allocations)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    std::getline(file, line); // Skip header
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        std::vector<std::string> fields = detail::splitCsvLine(line);
+        std::time_t usedFrom = parseTimestamp(detail::fieldAt(fields, 3));
+        std::time_t usedUntil = parseTimestamp(detail::fieldAt(fields, 4));
+        if (usedFrom == -1 || usedUntil == -1)
+        {
+            std::cerr << "Error: Time format invalid for: " << line << std::endl;
+            continue;
+        }
+
+        allocations.push_back({fields[0], fields[1], fields[2], usedFrom, usedUntil, detail::fieldAt(fields, 5) == "Yes"});
+    }
+    return true;
+}
+
+// IP Address,EC2 Instance,Associated From,Associated Until
+inline bool loadElasticIPAssociations(const std::string &filename, std::vector<ElasticIPAssociation> &associations)
+{
+    std::ifstream file;
+    if (!detail::openCsv(filename, file))
+        return false;
+
+    std::string line;
+    std::getline(file, line); // Skip header
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        std::vector<std::string> fields = detail::splitCsvLine(line);
+        std::time_t associatedFrom = parseTimestamp(detail::fieldAt(fields, 2));
+        std::time_t associatedUntil = parseTimestamp(detail::fieldAt(fields, 3));
+        if (associatedFrom == -1 || associatedUntil == -1)
+        {
+            std::cerr << "Error: Time format invalid for: " << line << std::endl;
+            continue;
+        }
+
+        associations.push_back({fields[0], fields[1], associatedFrom, associatedUntil});
+    }
+    return true;
+}
+
+// Remaining free tier hours of one customer, per region and month. Usage must be consumed in start
+// time order so that the earliest hours of the month are the free ones.
+class FreeTierLedger
+{
+public:
+    // Deducts up to 'hours' from the allowance and returns how many of them are free
+    double consume(const std::string &region, const std::string &monthYear, double hours, double allowance)
+    {
+        double &left = remaining.emplace(region + "_" + monthYear, allowance).first->second;
+        double freeHours = std::min(left, std::max(0.0, hours));
+        left -= freeHours;
+        return freeHours;
+    }
+
+    void clear()
+    {
+        remaining.clear();
+    }
+
+private:
+    std::unordered_map<std::string, double> remaining;
+};
+
+// enhancement1: the reserved instance that prices a usage row instead of the on-demand rate, if any
+inline const ReservedInstance *findReservedInstance(const ResourceUsage &usage, const ReservedInstance *reservedInstances,
+                                                    std::size_t reservedCount)
+{
+    for (std::size_t r = 0; r < reservedCount; ++r)
+    {
+        const ReservedInstance &instance = reservedInstances[r];
+        if (instance.customerId == usage.customerId && instance.resourceType == usage.resourceType &&
+            instance.region == usage.region && instance.os == usage.os)
+        {
+            return &instance;
+        }
+    }
+    return nullptr;
+}
+
+// enhancement1: usage row indices by customer, then start time. The free tier ledger must see each
+// customer's usage in this order so that the earliest hours of the month are the free ones.
+inline std::vector<std::size_t> freeTierOrder(const ResourceUsage *usages, std::size_t count)
+{
+    // Sort row indices only if they are not already in order
+    auto earlier = [usages](std::size_t a, std::size_t b) {
+        return std::tie(usages[a].customerId, usages[a].usedFrom) < std::tie(usages[b].customerId, usages[b].usedFrom);
+    };
+    std::vector<std::size_t> order(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        order[i] = i;
+    }
+    if (!std::is_sorted(order.begin(), order.end(), earlier))
+        std::stable_sort(order.begin(), order.end(), earlier);
+    return order;
+}
+
+// enhancement1: free hours of an on-demand usage row. Usage of the region's free tier instance type is free
+// until the customer's monthly allowance for that region runs out; the row crossing the cap is free in part.
+inline double consumeFreeTier(FreeTierLedger &ledger, const ResourceUsage &usage,
+                              const std::map<std::string, RegionInfo> &regionInfos)
+{
+    auto regionInfo = regionInfos.find(usage.region);
+    if (regionInfo == regionInfos.end() || regionInfo->second.freeTierInstanceType != usage.resourceType)
+        return 0.0;
+
+    return ledger.consume(usage.region, monthKey(usage.usedFrom), hoursBetween(usage.usedFrom, usage.usedUntil),
+                          regionInfo->second.freeTierHoursPerMonth);
+}
+
+// The free hours of a row are its first ones
+inline std::time_t freeTierUntil(const ResourceUsage &usage, double freeHours)
+{
+    return usage.usedFrom + static_cast<std::time_t>(std::llround(freeHours * 3600.0));
+}
+
+// enhancement2: the stretches of an allocation, in time order, during which its address is not associated
+// with an EC2 instance; only these are billed. Overlapping associations are merged, so no time is deducted twice.
+inline std::vector<std::pair<std::time_t, std::time_t>> unassociatedStretches(const ElasticIPAllocation &allocation,
+                                                                              const ElasticIPAssociation *associations,
+                                                                              std::size_t associationCount)
+{
+    std::vector<std::pair<std::time_t, std::time_t>> associated;
+    for (std::size_t i = 0; i < associationCount; ++i)
+    {
+        const ElasticIPAssociation &association = associations[i];
+        std::time_t overlapStart = std::max(allocation.usedFrom, association.associatedFrom);
+        std::time_t overlapEnd = std::min(allocation.usedUntil, association.associatedUntil);
+        if (association.ipAddress == allocation.elasticIP && overlapEnd > overlapStart)
+            associated.emplace_back(overlapStart, overlapEnd);
+    }
+    std::sort(associated.begin(), associated.end());
+
+    std::vector<std::pair<std::time_t, std::time_t>> stretches;
+    std::time_t unassociatedFrom = allocation.usedFrom;
+    for (const auto &stretch : associated)
+    {
+        if (stretch.first > unassociatedFrom)
+            stretches.emplace_back(unassociatedFrom, stretch.first);
+        unassociatedFrom = std::max(unassociatedFrom, stretch.second);
+    }
+    if (allocation.usedUntil > unassociatedFrom)
+        stretches.emplace_back(unassociatedFrom, allocation.usedUntil);
+    return stretches;
+}
+
+// Usage reduced to hours that do not depend on any price, so it can be priced under one or many rate
+// tables with a single sparse matrix product (see priceAggregate). Row r is one bill line; a column is one
+// price period of one rate key. A key's periods split time only at its own price changes in the tables to
+// be used, so each table has one rate per column and a line's amount is the sum of its hours times those rates.
+struct UsageAggregate
+{
+    std::vector<BillLineItem> rows;        // Bill lines with everything but the priced fields set
+    std::vector<double> ratedHours;        // Per row, the hours ratePerHour is quoted over
+    std::vector<double> fixedAmounts;      // Per row, the part of the amount no rate table changes
+    std::vector<std::string> rateKeys;     // Key k owns columns keyColumns[k] up to keyColumns[k + 1]
+    std::vector<std::size_t> keyColumns;
+    std::vector<std::time_t> periodStarts; // Per column; a key's first period starts at the beginning of time
+
+    // Compressed sparse rows: row r holds entries rowOffsets[r] up to rowOffsets[r + 1]. The hours of a
+    // discounted entry are given back as a discount, such as free tier hours, rather than charged.
+    std::vector<std::size_t> rowOffsets;
+    std::vector<std::size_t> columns;
+    std::vector<double> hours;
+    std::vector<char> discounted;
+
+    std::size_t columnCount() const
+    {
+        return periodStarts.size();
+    }
+};
+
+namespace detail
+{
+
+class AggregateBuilder
+{
+public:
+    explicit AggregateBuilder(const PeriodBoundaries &boundaries) : boundaries(boundaries)
+    {
+        aggregate.keyColumns.push_back(0);
+    }
+
+    // Index of the row with the key fields of 'key', added on first use. Within a customer's month
+    // such rows are ordered by key.
+    std::size_t row(const BillLineItem &key)
+    {
+        std::string id = key.customerId + '\x1f' + key.monthYear + '\x1f' + key.region + '\x1f' + key.resourceType +
+                         '\x1f' + key.os + '\x1f' + key.resourceId;
+        auto inserted = rowIndex.emplace(id, rows.size());
+        if (inserted.second)
+            addRow(key, id);
+        return inserted.first->second;
+    }
+
+    // Adds a row of its own; within a customer's month such rows keep the order they are added in
+    std::size_t appendRow(const BillLineItem &line)
+    {
+        addRow(line, line.customerId + '\x1f' + line.monthYear);
+        return rows.size() - 1;
+    }
+
+    BillLineItem &line(std::size_t row)
+    {
+        return rows[row].line;
+    }
+
+    void addRatedHours(std::size_t row, double hours)
+    {
+        rows[row].ratedHours += hours;
+    }
+
+    void addFixed(std::size_t row, double amount)
+    {
+        rows[row].fixedAmount += amount;
+    }
+
+    // Adds the hours of [from, until) to a row, split at the period starts
+    void charge(std::size_t row, const std::string &rateKey, std::time_t from, std::time_t until)
+    {
+        split(rows[row].charged, rateKey, from, until);
+    }
+
+    // Same as charge, for hours given back as a discount
+    void discount(std::size_t row, const std::string &rateKey, std::time_t from, std::time_t until)
+    {
+        split(rows[row].discounted, rateKey, from, until);
+    }
+
+    UsageAggregate finish()
+    {
+        // Rows by customer and then month, like the bills
+        std::vector<std::size_t> order(rows.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [this](std::size_t a, std::size_t b) { return rows[a].sortKey < rows[b].sortKey; });
+
+        aggregate.rowOffsets.push_back(0);
+        for (std::size_t index : order)
+        {
+            Row &row = rows[index];
+            aggregate.rows.push_back(std::move(row.line));
+            aggregate.ratedHours.push_back(row.ratedHours);
+            aggregate.fixedAmounts.push_back(row.fixedAmount);
+            appendCells(row.charged, false);
+            appendCells(row.discounted, true);
+            aggregate.rowOffsets.push_back(aggregate.columns.size());
+        }
+        return std::move(aggregate);
+    }
+
+private:
+    using Cells = std::map<std::size_t, double>; // Hours per column
+
+    struct Row
+    {
+        BillLineItem line;
+        std::string sortKey;
+        double ratedHours = 0.0;
+        double fixedAmount = 0.0;
+        Cells charged;
+        Cells discounted;
+    };
+
+    void addRow(const BillLineItem &line, const std::string &sortKey)
+    {
+        rows.emplace_back();
+        rows.back().line = line;
+        rows.back().sortKey = sortKey;
+    }
+
+    void split(Cells &cells, const std::string &rateKey, std::time_t from, std::time_t until)
+    {
+        if (until <= from)
+            return;
+
+        std::size_t key = keyIndex(rateKey);
+        auto starts = aggregate.periodStarts.begin() + aggregate.keyColumns[key];
+        auto end = aggregate.periodStarts.begin() + aggregate.keyColumns[key + 1];
+        auto period = std::upper_bound(starts, end, from) - 1;
+        for (; period != end && *period < until; ++period)
+        {
+            std::time_t segmentStart = std::max(from, *period);
+            std::time_t segmentEnd = period + 1 != end ? std::min(until, *(period + 1)) : until;
+            cells[period - aggregate.periodStarts.begin()] += hoursBetween(segmentStart, segmentEnd);
+        }
+    }
+
+    // Index of a rate key, whose columns are added on first use: one period from the beginning of
+    // time, then one from each of its boundaries
+    std::size_t keyIndex(const std::string &rateKey)
+    {
+        auto inserted = rateKeyIndex.emplace(rateKey, aggregate.rateKeys.size());
+        if (inserted.second)
+        {
+            aggregate.rateKeys.push_back(rateKey);
+            aggregate.periodStarts.push_back(std::numeric_limits<std::time_t>::min());
+            auto keyBoundaries = boundaries.find(rateKey);
+            if (keyBoundaries != boundaries.end())
+            {
+                aggregate.periodStarts.insert(aggregate.periodStarts.end(), keyBoundaries->second.begin(),
+                                              keyBoundaries->second.end());
+            }
+            aggregate.keyColumns.push_back(aggregate.periodStarts.size());
+        }
+        return inserted.first->second;
+    }
+
+    void appendCells(const Cells &cells, bool discounted)
+    {
+        for (const auto &cell : cells)
+        {
+            aggregate.columns.push_back(cell.first);
+            aggregate.hours.push_back(cell.second);
+            aggregate.discounted.push_back(discounted);
+        }
+    }
+
+    const PeriodBoundaries &boundaries;
+    UsageAggregate aggregate;
+    std::vector<Row> rows;
+    std::map<std::string, std::size_t> rowIndex;
+    std::map<std::string, std::size_t> rateKeyIndex;
+};
+
+} // namespace detail
+
+// Aggregators. 'boundaries' are the price changes, per rate key, of every rate table the result will be
+// priced under; see periodBoundaries.
+
+// enhancement0: one line per customer, month and instance type, with usage hours summed
+inline UsageAggregate aggregateInstanceUsage(const InstanceUsage *usages, std::size_t count,
+                                             const PeriodBoundaries &boundaries)
+{
+    detail::AggregateBuilder builder(boundaries);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const InstanceUsage &usage = usages[i];
+        BillLineItem key;
+        key.customerId = usage.customerId;
+        key.monthYear = monthKey(usage.usedFrom);
+        key.resourceType = usage.instanceType;
+        std::size_t row = builder.row(key);
+
+        double hoursUsed = hoursBetween(usage.usedFrom, usage.usedUntil);
+        builder.line(row).usedHours += hoursUsed;
+        builder.addRatedHours(row, hoursUsed);
+        builder.charge(row, usage.instanceType, usage.usedFrom, usage.usedUntil);
+    }
+
+    UsageAggregate aggregate = builder.finish();
+    for (BillLineItem &line : aggregate.rows)
+    {
+        line.billedHours = std::ceil(line.usedHours);
+    }
+    return aggregate;
+}
+
+// enhancement1: one line per usage row, listed in start time order within a bill. Rows are priced on
+// demand unless a reserved instance matches, which makes the amount fixed. Free tier hours (see
+// consumeFreeTier) of on-demand rows are discounted at the on-demand rate; reserved usage neither uses
+// up nor receives the free tier.
+inline UsageAggregate aggregateResourceUsage(const ResourceUsage *usages, std::size_t count,
+                                             const ReservedInstance *reservedInstances, std::size_t reservedCount,
+                                             const std::map<std::string, RegionInfo> &regionInfos,
+                                             const PeriodBoundaries &boundaries)
+{
+    std::vector<std::size_t> order = freeTierOrder(usages, count);
+
+    detail::AggregateBuilder builder(boundaries);
+    FreeTierLedger ledger;
+    for (std::size_t n = 0; n < count; ++n)
+    {
+        const ResourceUsage &usage = usages[order[n]];
+        if (n > 0 && usages[order[n - 1]].customerId != usage.customerId)
+            ledger.clear(); // One customer at a time so the ledger only ever holds one customer's months
+
+        double hoursUsed = hoursBetween(usage.usedFrom, usage.usedUntil);
+        BillLineItem line;
+        line.customerId = usage.customerId;
+        line.monthYear = monthKey(usage.usedFrom);
+        line.region = usage.region;
+        line.resourceType = usage.resourceType;
+        line.os = usage.os;
+        line.usedHours = hoursUsed;
+        line.billedHours = hoursUsed;
+        std::size_t row = builder.appendRow(line);
+        builder.addRatedHours(row, hoursUsed);
+
+        // Check for reserved instance usage and override rate if applicable
+        if (const ReservedInstance *instance = findReservedInstance(usage, reservedInstances, reservedCount))
+        {
+            builder.addFixed(row, hoursUsed * instance->hourlyRate);
+            continue;
+        }
+
+        std::string rateKey = resourceRateKey(usage.region, usage.resourceType);
+        builder.charge(row, rateKey, usage.usedFrom, usage.usedUntil);
+
+        double freeHours = consumeFreeTier(ledger, usage, regionInfos);
+        if (freeHours > 0)
+            builder.discount(row, rateKey, usage.usedFrom, freeTierUntil(usage, freeHours));
+    }
+    return builder.finish();
+}
+
+// enhancement2: one line per allocation, billed for its unassociated stretches; customers' own IPs are free
+inline UsageAggregate aggregateElasticIPs(const ElasticIPAllocation *allocations, std::size_t count,
+                                          const ElasticIPAssociation *associations, std::size_t associationCount,
+                                          const PeriodBoundaries &boundaries)
+{
+    detail::AggregateBuilder builder(boundaries);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const ElasticIPAllocation &allocation = allocations[i];
+        BillLineItem line;
+        line.customerId = allocation.customer;
+        line.monthYear = monthKey(allocation.usedFrom);
+        line.region = allocation.region;
+        line.resourceId = allocation.elasticIP;
+        line.isOwnIP = allocation.isOwnIP;
+        line.usedHours = hoursBetween(allocation.usedFrom, allocation.usedUntil);
+        std::size_t row = builder.appendRow(line);
+        if (allocation.isOwnIP)
+            continue;
+
+        for (const auto &stretch : unassociatedStretches(allocation, associations, associationCount))
+        {
+            double billedHours = hoursBetween(stretch.first, stretch.second);
+            builder.line(row).billedHours += billedHours;
+            builder.addRatedHours(row, billedHours);
+            builder.charge(row, allocation.region, stretch.first, stretch.second);
+        }
+    }
+    return builder.finish();
+}
+
+// Amounts and discounts of every aggregate row under every rate table, rows x tables in row major order
+struct AggregatePrices
+{
+    std::size_t tableCount = 0;
+    std::vector<double> amounts;
+    std::vector<double> discounts;
+    std::vector<std::map<std::string, double>> unpricedHours; // Per table, charged hours no rate covers, by rate key
+};
+
+// Prices an aggregate under every table at once. The rates form a dense columns x tables matrix, so each
+// sparse entry updates all tables in one contiguous inner loop.
+inline AggregatePrices priceAggregate(const UsageAggregate &aggregate, const std::vector<const RateTable *> &tables)
+{
+    std::size_t tableCount = tables.size();
+
+    std::vector<double> rates(aggregate.columnCount() * tableCount, 0.0);
+    std::vector<char> covered(aggregate.columnCount() * tableCount, false);
+    for (std::size_t key = 0; key < aggregate.rateKeys.size(); ++key)
+    {
+        for (std::size_t t = 0; t < tableCount; ++t)
+        {
+            auto entry = tables[t]->find(aggregate.rateKeys[key]);
+            if (entry == tables[t]->end())
+                continue;
+
+            for (std::size_t column = aggregate.keyColumns[key]; column < aggregate.keyColumns[key + 1]; ++column)
+            {
+                std::size_t cell = column * tableCount + t;
+                if (const RateVersion *version = versionAt(entry->second, aggregate.periodStarts[column]))
+                {
+                    rates[cell] = version->ratePerHour;
+                    covered[cell] = true;
+                }
+            }
+        }
+    }
+
+    AggregatePrices prices;
+    prices.tableCount = tableCount;
+    prices.amounts.resize(aggregate.rows.size() * tableCount);
+    prices.discounts.assign(aggregate.rows.size() * tableCount, 0.0);
+    std::vector<double> chargedHours(aggregate.columnCount(), 0.0);
+    for (std::size_t row = 0; row < aggregate.rows.size(); ++row)
+    {
+        double *rowAmounts = &prices.amounts[row * tableCount];
+        double *rowDiscounts = &prices.discounts[row * tableCount];
+        for (std::size_t t = 0; t < tableCount; ++t)
+        {
+            rowAmounts[t] = aggregate.fixedAmounts[row];
+        }
+
+        for (std::size_t entry = aggregate.rowOffsets[row]; entry < aggregate.rowOffsets[row + 1]; ++entry)
+        {
+            const double hours = aggregate.hours[entry];
+            const double *columnRates = &rates[aggregate.columns[entry] * tableCount];
+            double *target = aggregate.discounted[entry] ? rowDiscounts : rowAmounts;
+            for (std::size_t t = 0; t < tableCount; ++t)
+            {
+                target[t] += hours * columnRates[t];
+            }
+
+            if (!aggregate.discounted[entry])
+                chargedHours[aggregate.columns[entry]] += hours;
+        }
+    }
+
+    prices.unpricedHours.resize(tableCount);
+    for (std::size_t key = 0; key < aggregate.rateKeys.size(); ++key)
+    {
+        for (std::size_t column = aggregate.keyColumns[key]; column < aggregate.keyColumns[key + 1]; ++column)
+        {
+            for (std::size_t t = 0; t < tableCount && chargedHours[column] > 0; ++t)
+            {
+                if (!covered[column * tableCount + t])
+                    prices.unpricedHours[t][aggregate.rateKeys[key]] += chargedHours[column];
+            }
+        }
+    }
+    return prices;
+}
+
+// The bill lines of an aggregate priced under the table at index 'table' of priceAggregate
+inline std::vector<BillLineItem> billLines(const UsageAggregate &aggregate, const AggregatePrices &prices,
+                                           std::size_t table)
+{
+    std::vector<BillLineItem> lines = aggregate.rows;
+    for (std::size_t row = 0; row < lines.size(); ++row)
+    {
+        BillLineItem &line = lines[row];
+        line.amount = prices.amounts[row * prices.tableCount + table];
+        line.discount = prices.discounts[row * prices.tableCount + table];
+        line.actualAmount = line.amount - line.discount;
+        line.ratePerHour = aggregate.ratedHours[row] > 0 ? line.amount / aggregate.ratedHours[row] : 0.0;
+    }
+    return lines;
+}
+
+// Billers: aggregate the usage and price it under one rate table. Line items come back ordered by
+// customer, then month, one bill after another. Usage no rate covers is billed nothing; its hours per
+// rate key go to unpricedHours when given, and are reported on std::cerr otherwise.
+
+inline std::vector<BillLineItem> billAggregate(const UsageAggregate &aggregate, const RateTable &rates,
+                                               std::map<std::string, double> *unpricedHours = nullptr)
+{
+    AggregatePrices prices = priceAggregate(aggregate, {&rates});
+    if (unpricedHours != nullptr)
+        *unpricedHours = prices.unpricedHours[0];
+    else
+        detail::reportUnpricedHours(prices.unpricedHours[0]);
+    return billLines(aggregate, prices, 0);
+}
+
+// enhancement0, see aggregateInstanceUsage
+inline std::vector<BillLineItem> billInstanceUsage(const InstanceUsage *usages, std::size_t count, const RateTable &rates,
+                                                   std::map<std::string, double> *unpricedHours = nullptr)
+{
+    return billAggregate(aggregateInstanceUsage(usages, count, periodBoundaries({&rates})), rates, unpricedHours);
+}
+
+// enhancement1, see aggregateResourceUsage
+inline std::vector<BillLineItem> billResourceUsage(const ResourceUsage *usages, std::size_t count,
+                                                   const ReservedInstance *reservedInstances, std::size_t reservedCount,
+                                                   const RateTable &rates,
+                                                   const std::map<std::string, RegionInfo> &regionInfos,
+                                                   std::map<std::string, double> *unpricedHours = nullptr)
+{
+    return billAggregate(aggregateResourceUsage(usages, count, reservedInstances, reservedCount, regionInfos,
+                                                periodBoundaries({&rates})),
+                         rates, unpricedHours);
+}
+
+// enhancement2, see aggregateElasticIPs. Throws std::out_of_range when a billable allocation's region has no rate.
+inline std::vector<BillLineItem> billElasticIPs(const ElasticIPAllocation *allocations, std::size_t count,
+                                                const ElasticIPAssociation *associations, std::size_t associationCount,
+                                                const RateTable &rates,
+                                                std::map<std::string, double> *unpricedHours = nullptr)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (!allocations[i].isOwnIP && rates.find(allocations[i].region) == rates.end())
+            throw std::out_of_range("No Elastic IP rate for region: " + allocations[i].region);
+    }
+    return billAggregate(aggregateElasticIPs(allocations, count, associations, associationCount,
+                                             periodBoundaries({&rates})),
+                         rates, unpricedHours);
+}
+
+// Splits a biller's result into the individual monthly bills
+inline std::vector<MonthlyBill> splitMonthlyBills(const std::vector<BillLineItem> &lines)
+{
+    std::vector<MonthlyBill> bills;
+    for (const BillLineItem &line : lines)
+    {
+        if (bills.empty() || bills.back().customerId != line.customerId || bills.back().monthYear != line.monthYear)
+        {
+            bills.push_back({line.customerId, line.monthYear, &line, &line});
+        }
+        bills.back().end = &line + 1;
+    }
+    return bills;
+}
+
+} // namespace billing
+
+#endif // BILLING_BILLING_H
@@ -0,0 +1,250 @@
+#include "billing_c.h"
+#include "billing.h"
+
+#include <exception>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct billing_result
+{
+    std::vector<billing::BillLineItem> lines;
+    std::vector<billing_line_item> items; // Views into lines
+    double unpricedHours = 0.0;
+};
+
+namespace
+{
+
+thread_local std::string lastError;
+
+void require(const void *column, size_t count, const char *name)
+{
+    if (count > 0 && column == nullptr)
+        throw std::invalid_argument(std::string("Missing column: ") + name);
+}
+
+std::string stringAt(const char *const *column, size_t index)
+{
+    return column && column[index] ? column[index] : "";
+}
+
+billing::RateTable toRateTable(const billing_rate_columns *rates)
+{
+    billing::RateTable table;
+    if (rates == nullptr)
+        return table;
+
+    require(rates->key, rates->count, "rates.key");
+    require(rates->rate_per_hour, rates->count, "rates.rate_per_hour");
+    for (size_t i = 0; i < rates->count; ++i)
+    {
+        billing::RateVersion version;
+        version.ratePerHour = rates->rate_per_hour[i];
+        if (rates->effective_from)
+            version.effectiveFrom = static_cast<std::time_t>(rates->effective_from[i]);
+        if (rates->effective_until)
+            version.effectiveUntil = static_cast<std::time_t>(rates->effective_until[i]);
+        std::string key = stringAt(rates->key, i);
+        if (rates->region)
+            key = billing::resourceRateKey(stringAt(rates->region, i), key);
+        billing::addRateVersion(table, key, version);
+    }
+    billing::sortRateTable(table, "billing_rate_columns");
+    return table;
+}
+
+billing_result *toResult(std::vector<billing::BillLineItem> lines, const std::map<std::string, double> &unpricedHours)
+{
+    billing_result *result = new billing_result;
+    result->lines = std::move(lines);
+    for (const auto &entry : unpricedHours)
+    {
+        result->unpricedHours += entry.second;
+    }
+    result->items.reserve(result->lines.size());
+    for (const billing::BillLineItem &line : result->lines)
+    {
+        result->items.push_back({line.customerId.c_str(), line.monthYear.c_str(), line.region.c_str(),
+                                 line.resourceType.c_str(), line.os.c_str(), line.resourceId.c_str(),
+                                 line.isOwnIP ? 1 : 0, line.totalResources, line.usedHours, line.billedHours,
+                                 line.ratePerHour, line.amount, line.discount, line.actualAmount});
+    }
+    return result;
+}
+
+// Runs a biller, which collects unpriced usage hours instead of printing them, turning any exception
+// into a NULL result and a message for billing_last_error
+template <typename Biller>
+billing_result *guarded(Biller biller)
+{
+    lastError.clear();
+    try
+    {
+        std::map<std::string, double> unpricedHours;
+        std::vector<billing::BillLineItem> lines = biller(unpricedHours);
+        return toResult(std::move(lines), unpricedHours);
+    }
+    catch (const std::exception &e)
+    {
+        lastError = e.what();
+    }
+    catch (...)
+    {
+        lastError = "Unknown error";
+    }
+    return nullptr;
+}
+
+} // namespace
+
+extern "C" billing_result *billing_bill_instance_usage(const billing_instance_usage_columns *usage,
+                                                       const billing_rate_columns *rates)
+{
+    return guarded([&](std::map<std::string, double> &unpricedHours) {
+        if (usage == nullptr)
+            throw std::invalid_argument("Missing usage");
+        require(usage->customer_id, usage->count, "usage.customer_id");
+        require(usage->instance_type, usage->count, "usage.instance_type");
+        require(usage->used_from, usage->count, "usage.used_from");
+        require(usage->used_until, usage->count, "usage.used_until");
+
+        std::vector<billing::InstanceUsage> usages;
+        usages.reserve(usage->count);
+        for (size_t i = 0; i < usage->count; ++i)
+        {
+            usages.push_back({stringAt(usage->customer_id, i), stringAt(usage->instance_id, i),
+                              stringAt(usage->instance_type, i), static_cast<std::time_t>(usage->used_from[i]),
+                              static_cast<std::time_t>(usage->used_until[i])});
+        }
+        return billing::billInstanceUsage(usages.data(), usages.size(), toRateTable(rates), &unpricedHours);
+    });
+}
+
+extern "C" billing_result *billing_bill_resource_usage(const billing_resource_usage_columns *usage,
+                                                       const billing_reserved_instance_columns *reserved,
+                                                       const billing_rate_columns *rates,
+                                                       const billing_region_columns *regions)
+{
+    return guarded([&](std::map<std::string, double> &unpricedHours) {
+        if (usage == nullptr)
+            throw std::invalid_argument("Missing usage");
+        require(usage->customer_id, usage->count, "usage.customer_id");
+        require(usage->resource_type, usage->count, "usage.resource_type");
+        require(usage->region, usage->count, "usage.region");
+        require(usage->os, usage->count, "usage.os");
+        require(usage->used_from, usage->count, "usage.used_from");
+        require(usage->used_until, usage->count, "usage.used_until");
+
+        if (rates != nullptr)
+            require(rates->region, rates->count, "rates.region"); // Rates are per region and instance type
+
+        std::vector<billing::ResourceUsage> usages;
+        usages.reserve(usage->count);
+        for (size_t i = 0; i < usage->count; ++i)
+        {
+            usages.push_back({stringAt(usage->customer_id, i), stringAt(usage->instance_id, i),
+                              stringAt(usage->resource_type, i), stringAt(usage->region, i), stringAt(usage->os, i),
+                              static_cast<std::time_t>(usage->used_from[i]),
+                              static_cast<std::time_t>(usage->used_until[i])});
+        }
+
+        std::vector<billing::ReservedInstance> reservedInstances;
+        if (reserved != nullptr)
+        {
+            require(reserved->hourly_rate, reserved->count, "reserved.hourly_rate");
+            for (size_t i = 0; i < reserved->count; ++i)
+            {
+                billing::ReservedInstance instance;
+                instance.customerId = stringAt(reserved->customer_id, i);
+                instance.resourceType = stringAt(reserved->resource_type, i);
+                instance.region = stringAt(reserved->region, i);
+                instance.os = stringAt(reserved->os, i);
+                instance.hourlyRate = reserved->hourly_rate[i];
+                reservedInstances.push_back(instance);
+            }
+        }
+
+        std::map<std::string, billing::RegionInfo> regionInfos;
+        if (regions != nullptr)
+        {
+            for (size_t i = 0; i < regions->count; ++i)
+            {
+                std::string region = stringAt(regions->region, i);
+                regionInfos[region] = {region, stringAt(regions->free_tier_instance_type, i),
+                                       regions->free_tier_hours ? regions->free_tier_hours[i]
+                                                                : billing::defaultFreeTierHoursPerMonth};
+            }
+        }
+
+        return billing::billResourceUsage(usages.data(), usages.size(), reservedInstances.data(),
+                                          reservedInstances.size(), toRateTable(rates), regionInfos, &unpricedHours);
+    });
+}
+
+extern "C" billing_result *billing_bill_elastic_ips(const billing_elastic_ip_allocation_columns *allocations,
+                                                    const billing_elastic_ip_association_columns *associations,
+                                                    const billing_rate_columns *rates)
+{
+    return guarded([&](std::map<std::string, double> &unpricedHours) {
+        if (allocations == nullptr)
+            throw std::invalid_argument("Missing allocations");
+        require(allocations->customer_id, allocations->count, "allocations.customer_id");
+        require(allocations->region, allocations->count, "allocations.region");
+        require(allocations->used_from, allocations->count, "allocations.used_from");
+        require(allocations->used_until, allocations->count, "allocations.used_until");
+
+        std::vector<billing::ElasticIPAllocation> allocationRecords;
+        allocationRecords.reserve(allocations->count);
+        for (size_t i = 0; i < allocations->count; ++i)
+        {
+            allocationRecords.push_back({stringAt(allocations->customer_id, i), stringAt(allocations->region, i),
+                                         stringAt(allocations->elastic_ip, i),
+                                         static_cast<std::time_t>(allocations->used_from[i]),
+                                         static_cast<std::time_t>(allocations->used_until[i]),
+                                         allocations->is_own_ip != nullptr && allocations->is_own_ip[i] != 0});
+        }
+
+        std::vector<billing::ElasticIPAssociation> associationRecords;
+        if (associations != nullptr)
+        {
+            require(associations->associated_from, associations->count, "associations.associated_from");
+            require(associations->associated_until, associations->count, "associations.associated_until");
+            for (size_t i = 0; i < associations->count; ++i)
+            {
+                associationRecords.push_back({stringAt(associations->ip_address, i), "",
+                                              static_cast<std::time_t>(associations->associated_from[i]),
+                                              static_cast<std::time_t>(associations->associated_until[i])});
+            }
+        }
+
+        return billing::billElasticIPs(allocationRecords.data(), allocationRecords.size(), associationRecords.data(),
+                                       associationRecords.size(), toRateTable(rates), &unpricedHours);
+    });
+}
+
+extern "C" size_t billing_result_count(const billing_result *result)
+{
+    return result ? result->items.size() : 0;
+}
+
+extern "C" const billing_line_item *billing_result_items(const billing_result *result)
+{
+    return result && !result->items.empty() ? result->items.data() : nullptr;
+}
+
+extern "C" void billing_free_result(billing_result *result)
+{
+    delete result;
+}
+
+extern "C" double billing_result_unpriced_hours(const billing_result *result)
+{
+    return result ? result->unpricedHours : 0.0;
+}
+
+extern "C" const char *billing_last_error(void)
+{
+    return lastError.c_str();
+}
@@ -0,0 +1,154 @@
+#ifndef BILLING_BILLING_C_H
+#define BILLING_BILLING_C_H
+
+/*
+ * C interface to the in-process billers in billing.h.
+ *
+ * Inputs are passed as columns: each struct holds `count` entries in parallel arrays.
+ * Times are epoch seconds; bills are grouped by calendar month in UTC, the same as the CSV
+ * programs, which read their timestamps as UTC. Optional columns may be NULL.
+ *
+ * Each bill function returns a result that must be released with billing_free_result,
+ * or NULL on failure, in which case billing_last_error describes the problem.
+ *
+ * Build as a shared library, e.g. g++ -std=c++17 -shared -fPIC billing_c.cpp -o libbilling.so
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Rate history, one row per price version. Key is the instance type (enhancement0/1) or region (enhancement2).
+ * enhancement1 prices are per region, so billing_bill_resource_usage requires the region column.
+ */
+typedef struct billing_rate_columns
+{
+    size_t count;
+    const char *const *key;
+    const double *rate_per_hour;
+    const int64_t *effective_from;  /* Optional, NULL means always in effect */
+    const int64_t *effective_until; /* Optional, NULL means always in effect */
+    const char *const *region;      /* Required by enhancement1, ignored otherwise */
+} billing_rate_columns;
+
+/* enhancement0 */
+typedef struct billing_instance_usage_columns
+{
+    size_t count;
+    const char *const *customer_id;
+    const char *const *instance_id; /* Optional */
+    const char *const *instance_type;
+    const int64_t *used_from;
+    const int64_t *used_until;
+} billing_instance_usage_columns;
+
+/* enhancement1 */
+typedef struct billing_resource_usage_columns
+{
+    size_t count;
+    const char *const *customer_id;
+    const char *const *instance_id; /* Optional */
+    const char *const *resource_type;
+    const char *const *region;
+    const char *const *os;
+    const int64_t *used_from;
+    const int64_t *used_until;
+} billing_resource_usage_columns;
+
+typedef struct billing_reserved_instance_columns
+{
+    size_t count;
+    const char *const *customer_id;
+    const char *const *resource_type;
+    const char *const *region;
+    const char *const *os;
+    const double *hourly_rate;
+} billing_reserved_instance_columns;
+
+typedef struct billing_region_columns
+{
+    size_t count;
+    const char *const *region;
+    const char *const *free_tier_instance_type;
+    const double *free_tier_hours; /* Optional, monthly allowance per customer; defaults to 750 */
+} billing_region_columns;
+
+/* enhancement2 */
+typedef struct billing_elastic_ip_allocation_columns
+{
+    size_t count;
+    const char *const *customer_id;
+    const char *const *region;
+    const char *const *elastic_ip;
+    const int64_t *used_from;
+    const int64_t *used_until;
+    const uint8_t *is_own_ip; /* Optional, non-zero for the customer's own address */
+} billing_elastic_ip_allocation_columns;
+
+typedef struct billing_elastic_ip_association_columns
+{
+    size_t count;
+    const char *const *ip_address;
+    const int64_t *associated_from;
+    const int64_t *associated_until;
+} billing_elastic_ip_association_columns;
+
+/* One row of a monthly bill; see billing::BillLineItem. Strings are owned by the result and never NULL. */
+typedef struct billing_line_item
+{
+    const char *customer_id;
+    const char *month_year; /* YYYY-MM */
+    const char *region;
+    const char *resource_type;
+    const char *os;
+    const char *resource_id;
+    int32_t is_own_ip;
+    int32_t total_resources;
+    double used_hours;
+    double billed_hours;
+    double rate_per_hour;
+    double amount;
+    double discount;
+    double actual_amount;
+} billing_line_item;
+
+typedef struct billing_result billing_result;
+
+billing_result *billing_bill_instance_usage(const billing_instance_usage_columns *usage,
+                                            const billing_rate_columns *rates);
+
+/* reserved and regions may be NULL */
+billing_result *billing_bill_resource_usage(const billing_resource_usage_columns *usage,
+                                            const billing_reserved_instance_columns *reserved,
+                                            const billing_rate_columns *rates,
+                                            const billing_region_columns *regions);
+
+/* associations may be NULL */
+billing_result *billing_bill_elastic_ips(const billing_elastic_ip_allocation_columns *allocations,
+                                         const billing_elastic_ip_association_columns *associations,
+                                         const billing_rate_columns *rates);
+
+/* Line items ordered by customer, then month */
+size_t billing_result_count(const billing_result *result);
+const billing_line_item *billing_result_items(const billing_result *result);
+
+/*
+ * Usage hours no rate covered, which are billed at 0: non-zero means the rates lack an instance
+ * type, region or period that the usage needs.
+ */
+double billing_result_unpriced_hours(const billing_result *result);
+
+void billing_free_result(billing_result *result);
+
+/* Message for the last failed call on this thread, or an empty string */
+const char *billing_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BILLING_BILLING_C_H */
@@ -0,0 +1,53 @@
+#ifndef BILLING_OPTIONS_H
+#define BILLING_OPTIONS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace billing
+{
+
+// Command line options shared by the three programs
+struct ProgramOptions
+{
+    std::string columnarFile;               // --export-columnar <file>: also write all line items to one columnar binary file
+    std::vector<std::string> scenarioFiles; // --scenarios <file>...: rate files to compare against the program's own
+};
+
+// Returns false, after printing the usage, on an unknown argument or an option missing its files
+inline bool parseProgramOptions(int argc, char *argv[], ProgramOptions &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool valid = false;
+        if (arg == "--export-columnar")
+        {
+            valid = i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0;
+            if (valid)
+                options.columnarFile = argv[++i];
+        }
+        else if (arg == "--scenarios")
+        {
+            // Every following argument up to the next option is a rate file
+            while (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0)
+            {
+                options.scenarioFiles.push_back(argv[++i]);
+                valid = true;
+            }
+        }
+
+        if (!valid)
+        {
+            std::cerr << "Error: Invalid argument: " << arg << "\n"
+                      << "Usage: " << argv[0] << " [--export-columnar <file>] [--scenarios <rate file>...]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace billing
+
+#endif // BILLING_OPTIONS_H
@@ -0,0 +1,253 @@
+#ifndef BILLING_RATES_H
+#define BILLING_RATES_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace billing
+{
+
+// One price of a resource type or region, valid over [effectiveFrom, effectiveUntil)
+struct RateVersion
+{
+    std::time_t effectiveFrom = std::numeric_limits<std::time_t>::min();
+    std::time_t effectiveUntil = std::numeric_limits<std::time_t>::max();
+    double ratePerHour = 0.0; // On-demand rate for EC2 instances
+};
+
+// Instance type or region -> price versions sorted by effectiveFrom
+using RateTable = std::map<std::string, std::vector<RateVersion>>;
+
+namespace detail
+{
+
+// Days from 1970-01-01 to a proleptic Gregorian date
+inline long long daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int yearOfEra = year - era * 400;
+    const int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097LL + dayOfEra - 719468;
+}
+
+// Proleptic Gregorian date of a count of days from 1970-01-01, the inverse of daysFromCivil
+inline void civilFromDays(long long days, int &year, int &month, int &day)
+{
+    days += 719468;
+    const long long era = (days >= 0 ? days : days - 146096) / 146097;
+    const int dayOfEra = static_cast<int>(days - era * 146097);
+    const int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const int shiftedMonth = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    year = static_cast<int>(yearOfEra + era * 400) + (month <= 2);
+}
+
+// Splits epoch seconds into a UTC date and seconds into that day. Unlike std::gmtime this shares no
+// static storage, so it is safe to call from several threads at once.
+inline void civilFromTime(std::time_t time, int &year, int &month, int &day, int &secondOfDay)
+{
+    long long seconds = time;
+    long long days = seconds / 86400;
+    secondOfDay = static_cast<int>(seconds % 86400);
+    if (secondOfDay < 0)
+    {
+        --days;
+        secondOfDay += 86400;
+    }
+    civilFromDays(days, year, month, day);
+}
+
+} // namespace detail
+
+// Converts YYYY-MM-DDTHH:MM:SS (or YYYY-MM-DD) to epoch seconds, -1 on failure. The wall-clock time
+// is read as UTC, so hours and months come out the same whatever time zone the program runs in.
+inline std::time_t parseTimestamp(const std::string &timestamp)
+{
+    std::tm parsed = {};
+    std::istringstream ss(timestamp.size() == 10 ? timestamp + "T00:00:00" : timestamp);
+    ss >> std::get_time(&parsed, "%Y-%m-%dT%H:%M:%S");
+
+    if (ss.fail())
+        return -1;
+    long long days = detail::daysFromCivil(parsed.tm_year + 1900, parsed.tm_mon + 1, parsed.tm_mday);
+    return static_cast<std::time_t>(days * 86400 + parsed.tm_hour * 3600 + parsed.tm_min * 60 + parsed.tm_sec);
+}
+
+// Reads an optional effective-date column into 'time'; an empty value leaves it unchanged (that side of
+// the range stays open). Returns false when the date cannot be parsed.
+inline bool parseEffectiveTime(const std::string &value, std::time_t &time)
+{
+    if (value.empty())
+        return true;
+
+    std::time_t parsed = parseTimestamp(value);
+    if (parsed == -1)
+        return false;
+    time = parsed;
+    return true;
+}
+
+// YYYY-MM of a timestamp, the key bills are grouped by (UTC, matching parseTimestamp)
+inline std::string monthKey(std::time_t time)
+{
+    int year, month, day, secondOfDay;
+    detail::civilFromTime(time, year, month, day, secondOfDay);
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d", year, month);
+    return buffer;
+}
+
+inline double hoursBetween(std::time_t from, std::time_t until)
+{
+    return std::difftime(until, from) / 3600.0;
+}
+
+// Rates are written either as 0.0104 or $0.0104
+inline double parseRate(const std::string &value)
+{
+    return std::stod(!value.empty() && value[0] == '$' ? value.substr(1) : value);
+}
+
+// Adds a price version; a later row with the same key and start date replaces the earlier one
+inline void addRateVersion(RateTable &rates, const std::string &key, const RateVersion &version)
+{
+    std::vector<RateVersion> &versions = rates[key];
+    auto existing = std::find_if(versions.begin(), versions.end(),
+                                 [&](const RateVersion &v) { return v.effectiveFrom == version.effectiveFrom; });
+    if (existing != versions.end())
+        *existing = version;
+    else
+        versions.push_back(version);
+}
+
+// YYYY-MM-DDTHH:MM:SS of a timestamp, for messages
+inline std::string formatTimestamp(std::time_t time)
+{
+    int year, month, day, secondOfDay;
+    detail::civilFromTime(time, year, month, day, secondOfDay);
+    char buffer[48];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d", year, month, day, secondOfDay / 3600,
+                  secondOfDay / 60 % 60, secondOfDay % 60);
+    return buffer;
+}
+
+// Must be called once all versions are added, before any lookup. At any time the price of a key is the
+// newest version (latest Effective From) whose range covers it, so a dated row nested inside an open-ended
+// one only overrides its own range. Each key's versions are rewritten as the resulting stretches: sorted,
+// non-overlapping, and absent where no version applies. Gaps and overlaps between rows are reported,
+// naming 'source'.
+inline void sortRateTable(RateTable &rates, const std::string &source)
+{
+    for (auto &entry : rates)
+    {
+        std::vector<RateVersion> &versions = entry.second;
+        if (versions.empty())
+            continue;
+
+        std::sort(versions.begin(), versions.end(),
+                  [](const RateVersion &a, const RateVersion &b) { return a.effectiveFrom < b.effectiveFrom; });
+
+        std::vector<std::time_t> points;
+        std::time_t coveredUntil = versions.front().effectiveUntil;
+        for (std::size_t i = 0; i < versions.size(); ++i)
+        {
+            const RateVersion &version = versions[i];
+            if (i > 0 && version.effectiveFrom > coveredUntil)
+            {
+                std::cerr << "Warning: " << source << ": no rate for " << entry.first << " from "
+                          << formatTimestamp(coveredUntil) << " to " << formatTimestamp(version.effectiveFrom)
+                          << std::endl;
+            }
+            else if (i > 0 && version.effectiveFrom < coveredUntil)
+            {
+                std::cerr << "Warning: " << source << ": rates for " << entry.first << " overlap from "
+                          << formatTimestamp(version.effectiveFrom) << "; the row starting later applies there" << std::endl;
+            }
+            coveredUntil = std::max(coveredUntil, version.effectiveUntil);
+            points.push_back(version.effectiveFrom);
+            points.push_back(version.effectiveUntil);
+        }
+        std::sort(points.begin(), points.end());
+        points.erase(std::unique(points.begin(), points.end()), points.end());
+
+        // Price is constant between consecutive points; the last version covering a stretch is the newest
+        std::vector<RateVersion> stretches;
+        const RateVersion *previous = nullptr;
+        for (std::size_t p = 0; p + 1 < points.size(); ++p)
+        {
+            const RateVersion *newest = nullptr;
+            for (const RateVersion &version : versions)
+            {
+                if (version.effectiveFrom <= points[p] && points[p] < version.effectiveUntil)
+                    newest = &version;
+            }
+
+            if (newest != nullptr && newest == previous && stretches.back().effectiveUntil == points[p])
+            {
+                stretches.back().effectiveUntil = points[p + 1];
+            }
+            else if (newest != nullptr)
+            {
+                stretches.push_back(*newest);
+                stretches.back().effectiveFrom = points[p];
+                stretches.back().effectiveUntil = points[p + 1];
+            }
+            previous = newest;
+        }
+        versions = std::move(stretches);
+    }
+}
+
+// The stretch of a rate history resolved by sortRateTable in effect at one instant, nullptr when none is
+inline const RateVersion *versionAt(const std::vector<RateVersion> &versions, std::time_t time)
+{
+    // Binary search for the first stretch ending after 'time'
+    auto version = std::upper_bound(versions.begin(), versions.end(), time,
+                                    [](std::time_t t, const RateVersion &v) { return t < v.effectiveUntil; });
+    return version != versions.end() && version->effectiveFrom <= time ? &*version : nullptr;
+}
+
+// Rate key -> every price change of that key in the tables being used, sorted
+using PeriodBoundaries = std::map<std::string, std::vector<std::time_t>>;
+
+inline PeriodBoundaries periodBoundaries(const std::vector<const RateTable *> &tables)
+{
+    PeriodBoundaries boundaries;
+    for (const RateTable *table : tables)
+    {
+        for (const auto &entry : *table)
+        {
+            std::vector<std::time_t> &keyBoundaries = boundaries[entry.first];
+            for (const RateVersion &version : entry.second)
+            {
+                if (version.effectiveFrom != std::numeric_limits<std::time_t>::min())
+                    keyBoundaries.push_back(version.effectiveFrom);
+                if (version.effectiveUntil != std::numeric_limits<std::time_t>::max())
+                    keyBoundaries.push_back(version.effectiveUntil);
+            }
+        }
+    }
+    for (auto &entry : boundaries)
+    {
+        std::sort(entry.second.begin(), entry.second.end());
+        entry.second.erase(std::unique(entry.second.begin(), entry.second.end()), entry.second.end());
+    }
+    return boundaries;
+}
+
+} // namespace billing
+
+#endif // BILLING_RATES_H
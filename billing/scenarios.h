@@ -0,0 +1,117 @@
+#ifndef BILLING_SCENARIOS_H
+#define BILLING_SCENARIOS_H
+
+// What-if repricing: usage is aggregated once into hours that do not depend on any price (see
+// UsageAggregate in billing.h), then the baseline and every candidate rate table are evaluated against
+// that aggregate in one matrix product. The bills are the baseline column of that product, so a
+// scenario's differences are measured against exactly what was billed.
+
+#include "billing.h"
+
+#include <cstddef>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace billing
+{
+
+// Writes, per scenario and customer, month, region, instance type, OS and Elastic IP, the baseline
+// amount, the scenario amount and the difference, where table 0 of 'prices' is the baseline and table
+// s + 1 is scenario s. Also reports each scenario's total difference. Amounts are actual amounts, after
+// discounts. Returns false, after reporting the error, when the file cannot be created.
+inline bool writeScenarioDeltas(const std::string &filename, const UsageAggregate &aggregate,
+                                const AggregatePrices &prices, const std::vector<std::string> &scenarioNames)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to create file " << filename << std::endl;
+        return false;
+    }
+
+    // Lines sharing those key fields, such as several usage rows of one instance type, are summed
+    std::map<std::string, std::pair<const BillLineItem *, std::vector<double>>> rows;
+    std::size_t tableCount = prices.tableCount;
+    for (std::size_t row = 0; row < aggregate.rows.size(); ++row)
+    {
+        const BillLineItem &line = aggregate.rows[row];
+        std::string id = line.customerId + '\x1f' + line.monthYear + '\x1f' + line.region + '\x1f' +
+                         line.resourceType + '\x1f' + line.os + '\x1f' + line.resourceId;
+        auto &summed = rows.emplace(id, std::make_pair(&line, std::vector<double>(tableCount, 0.0))).first->second;
+        for (std::size_t t = 0; t < tableCount; ++t)
+        {
+            summed.second[t] += prices.amounts[row * tableCount + t] - prices.discounts[row * tableCount + t];
+        }
+    }
+
+    file << "Scenario,Customer ID,Month,Region,Resource Type,OS,IP Address,Baseline Amount,Scenario Amount,Delta\n";
+    file << std::fixed << std::setprecision(2);
+    for (std::size_t s = 0; s < scenarioNames.size(); ++s)
+    {
+        double totalDelta = 0.0;
+        for (const auto &row : rows)
+        {
+            const BillLineItem &key = *row.second.first;
+            double baselineAmount = row.second.second[0];
+            double scenarioAmount = row.second.second[s + 1];
+            totalDelta += scenarioAmount - baselineAmount;
+
+            file << scenarioNames[s] << "," << key.customerId << "," << key.monthYear << "," << key.region << ","
+                 << key.resourceType << "," << key.os << "," << key.resourceId << "," << baselineAmount << ","
+                 << scenarioAmount << "," << scenarioAmount - baselineAmount << "\n";
+        }
+        std::cout << "Scenario " << scenarioNames[s] << ": total delta $" << std::fixed << std::setprecision(2)
+                  << totalDelta << std::endl;
+    }
+    return true;
+}
+
+// Bills usage under the baseline rates. When scenario rate files are given (read with loadRates), the
+// usage is aggregated over the price periods of every table, the bills are priced in the same product as
+// the scenarios, and the differences are written to deltasFile. 'aggregate' is called with the period
+// boundaries and returns the UsageAggregate of the usage, e.g. by calling aggregateInstanceUsage.
+template <typename Aggregate>
+std::vector<BillLineItem> billWithScenarios(const RateTable &baseline, const std::vector<std::string> &scenarioFiles,
+                                            bool (*loadRates)(const std::string &, RateTable &),
+                                            const Aggregate &aggregate, const std::string &deltasFile)
+{
+    std::vector<std::string> scenarioNames;
+    std::vector<RateTable> scenarios;
+    for (const std::string &scenarioFile : scenarioFiles)
+    {
+        RateTable scenario;
+        if (loadRates(scenarioFile, scenario))
+        {
+            scenarioNames.push_back(scenarioFile);
+            scenarios.push_back(std::move(scenario));
+        }
+    }
+
+    std::vector<const RateTable *> tables = {&baseline};
+    for (const RateTable &scenario : scenarios)
+    {
+        tables.push_back(&scenario);
+    }
+
+    UsageAggregate usage = aggregate(periodBoundaries(tables));
+    AggregatePrices prices = priceAggregate(usage, tables);
+    detail::reportUnpricedHours(prices.unpricedHours[0]);
+    for (std::size_t s = 0; s < scenarios.size(); ++s)
+    {
+        detail::reportUnpricedHours(prices.unpricedHours[s + 1], scenarioNames[s]);
+    }
+
+    if (!scenarioFiles.empty())
+        writeScenarioDeltas(deltasFile, usage, prices, scenarioNames);
+    return billLines(usage, prices, 0);
+}
+
+} // namespace billing
+
+#endif // BILLING_SCENARIOS_H